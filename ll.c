@@ -9,8 +9,44 @@
 #include <ctype.h>
 #include <sys/wait.h>
 #include <fnmatch.h>
+#include <stddef.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#define ST_MTIME(st) ((st).st_mtim)
+#else
+#define ST_MTIME(st) ((st).st_mtimespec)
+#endif
 #define MAX_PATH_LEN 1024
-#define MAX_FILES 4096
+#define CACHE_SLOTS 64
+#define MAX_WATCHERS 64
+#define MAX_PENDING 16
+#define MAX_PANE_FILES 4096
+#define DAEMON_BACKOFF 5
+#define SCAN_TIMEOUT 30
+#define REQ_FOLLOW 1
+#define REQ_WATCH 2
+#define REQ_NOWAIT 4
+#define WATCH_ACK 0x6c6c7761
+#define WIRE_MAGIC 0x6c6c0002
+#define WATCH_MASK (IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVE | IN_DELETE_SELF | IN_MOVE_SELF | IN_MODIFY | IN_CLOSE_WRITE)
+#define BITS_PER_WORD (8 * sizeof(unsigned long))
+#define BITSET_WORDS(n) (((n) + BITS_PER_WORD - 1) / BITS_PER_WORD)
+#define BIT_TEST(set, i) (((set)[(i) / BITS_PER_WORD] >> ((i) % BITS_PER_WORD)) & 1UL)
+#define BIT_SET(set, i) ((set)[(i) / BITS_PER_WORD] |= 1UL << ((i) % BITS_PER_WORD))
+#define BIT_FLIP(set, i) ((set)[(i) / BITS_PER_WORD] ^= 1UL << ((i) % BITS_PER_WORD))
 #define C_RESET   "\x1b[0m"
 #define C_HILIGHT "\x1b[7m" 
 #define C_PS1_USER "\x1b[1;32m" 
@@ -38,6 +74,7 @@ enum editorKey {
     ARROW_RIGHT,
     ARROW_UP,
     ARROW_DOWN,
+    DIR_CHANGED,
     BACKSPACE = 127
 };
 #define KEY_QUIT 'q'
@@ -50,14 +87,99 @@ enum editorKey {
 #define KEY_TOGGLE_DOTFILES '.'
 #define KEY_SHELL '!'
 #define KEY_ESC 27
+#define KEY_SORT 's'
+#define KEY_REVERSE 'r'
+#define KEY_MARK ' '
+#define KEY_MARK_RANGE 'V'
+#define KEY_MARK_GLOB '*'
+#define KEY_INVERT 'v'
+#define KEY_UNMARK 'u'
+#define KEY_PAGE_DOWN ']'
+#define KEY_PAGE_UP '['
+#define KEY_SEEK 'o'
+#define HEX_CHUNK 16
+enum sortMode {
+    SORT_NATURAL,
+    SORT_SIZE,
+    SORT_MTIME,
+    SORT_CTIME,
+    SORT_EXTENSION,
+    SORT_COUNT
+};
+const char *sort_names[SORT_COUNT] = {"natural", "size", "mtime", "ctime", "extension"};
 struct FileInfo {
-    char *name;
     mode_t mode;
+    off_t size;
+    time_t mtime;
+    time_t ctime;
+    char *name;
+    int id;
+};
+#define RECORD_LEN offsetof(struct FileInfo, name)
+struct Snapshot {
+    char *data;
+    int len;
+    int refs;
+};
+struct DirCache {
+    char path[MAX_PATH_LEN];
+    int dotfiles;
+    int follow;
+    struct timespec mtime;
+    int wd;
+    int stale;
+    int scanning;
+    int rescan;
+    int notify;
+    int pending[MAX_PENDING];
+    int pending_count;
+    struct Snapshot *snap;
+    unsigned long last_used;
+};
+struct ScanJob {
+    char path[MAX_PATH_LEN];
+    int dotfiles;
+    int follow;
+    struct timespec mtime;
+    struct Snapshot *snap;
+};
+struct SendJob {
+    char path[MAX_PATH_LEN];
+    int follow;
+    int fd;
+    int skip;
+    struct Snapshot *snap;
+};
+struct PaneCache {
+    char path[MAX_PATH_LEN];
+    int follow;
+    int dotfiles;
+    int sort;
+    int reverse;
+    struct timespec mtime;
+    struct FileInfo *files;
+    int count;
+};
+struct Watcher {
+    int fd;
+    int wd;
 };
 struct termios orig_termios; 
 int screen_rows;
 int screen_cols;
 int show_dotfiles = 0; 
+int sort_mode = SORT_NATURAL;
+int sort_reverse = 0;
+struct DirCache dir_cache[CACHE_SLOTS];
+int dir_events = -1;
+struct Watcher watchers[MAX_WATCHERS];
+int watcher_count = 0;
+int scan_done[2] = {-1, -1};
+pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+time_t daemon_retry_at = 0;
+const struct FileInfo *order_table;
+struct PaneCache parent_pane;
+struct PaneCache preview_pane;
 struct abuf {
     char *b;
     int len;
@@ -70,10 +192,17 @@ void spawnShell(const char* current_path);
 void openFile(const char* file_path);
 int natural_strcasecmp(const char *a, const char *b);
 int compareFiles(const void *a, const void *b);
+void sortFiles(struct FileInfo *files, int count, int *cursor_pos);
+void arrangeFiles(struct FileInfo *files, int count, int **orders, int *cursor_pos);
+void reverseRuns(struct FileInfo *files, int count, int *cursor_pos);
+struct FileInfo *scanDir(const char *path, int follow, int dotfiles, int max, int *count);
+void freeFiles(struct FileInfo *files, int count);
+void runDaemon();
+int readPrompt(const char *prefix, char *input, int size);
 const char* getFileColor(const char *filename, mode_t mode);
 const char* getFileIcon(const char *filename, mode_t mode);
 void drawParentPane(struct abuf *ab, const char *path, const char* highlight_name, int x, int width, int height);
-void drawPreviewPane(struct abuf *ab, const char *base_path, const char *filename, int start_col, int width, int height);
+off_t drawPreviewPane(struct abuf *ab, const char *base_path, const char *filename, int start_col, int width, int height, off_t *offset);
 void listDir(const char *path);
 void abAppend(struct abuf *ab, const char *s, int len) {
     char *new = realloc(ab->b, ab->len + len);
@@ -129,6 +258,14 @@ int readKey() {
         return c;
     }
 }
+int waitKey(int notify_fd) {
+    if (notify_fd != -1) {
+        struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {notify_fd, POLLIN, 0}};
+        while (poll(fds, 2, -1) == -1 && errno == EINTR);
+        if (fds[1].revents && !(fds[0].revents & POLLIN)) return DIR_CHANGED;
+    }
+    return readKey();
+}
 int getWindowSize(int *rows, int *cols) {
     struct winsize ws;
     if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
@@ -161,15 +298,658 @@ int natural_strcasecmp(const char *a, const char *b) {
     }
     return tolower((unsigned char)*a) - tolower((unsigned char)*b);
 }
+int compareKey(const struct FileInfo *file_a, const struct FileInfo *file_b) {
+    int is_dir_a = S_ISDIR(file_a->mode);
+    int is_dir_b = S_ISDIR(file_b->mode);
+    if (is_dir_a != is_dir_b) return is_dir_b - is_dir_a;
+    int diff = 0;
+    switch (sort_mode) {
+        case SORT_SIZE:
+            diff = (file_a->size < file_b->size) - (file_a->size > file_b->size);
+            break;
+        case SORT_MTIME:
+            diff = (file_a->mtime < file_b->mtime) - (file_a->mtime > file_b->mtime);
+            break;
+        case SORT_CTIME:
+            diff = (file_a->ctime < file_b->ctime) - (file_a->ctime > file_b->ctime);
+            break;
+        case SORT_EXTENSION: {
+            const char *ext_a = strrchr(file_a->name, '.');
+            const char *ext_b = strrchr(file_b->name, '.');
+            diff = strcasecmp(ext_a ? ext_a : "", ext_b ? ext_b : "");
+            break;
+        }
+    }
+    return diff;
+}
 int compareFiles(const void *a, const void *b) {
+    const struct FileInfo *file_a = (const struct FileInfo *)a;
+    const struct FileInfo *file_b = (const struct FileInfo *)b;
+    if (!show_dotfiles) {
+        int hidden_a = file_a->name[0] == '.';
+        int hidden_b = file_b->name[0] == '.';
+        if (hidden_a != hidden_b) return hidden_a - hidden_b;
+    }
+    int is_dir_a = S_ISDIR(file_a->mode);
+    int is_dir_b = S_ISDIR(file_b->mode);
+    if (is_dir_a != is_dir_b) return is_dir_b - is_dir_a;
+    int diff = compareKey(file_a, file_b);
+    if (diff == 0) diff = natural_strcasecmp(file_a->name, file_b->name);
+    return sort_reverse ? -diff : diff;
+}
+int compareNatural(const void *a, const void *b) {
     const struct FileInfo *file_a = (const struct FileInfo *)a;
     const struct FileInfo *file_b = (const struct FileInfo *)b;
     int is_dir_a = S_ISDIR(file_a->mode);
     int is_dir_b = S_ISDIR(file_b->mode);
-    if (is_dir_a && !is_dir_b) return -1;
-    if (!is_dir_a && is_dir_b) return 1;
+    if (is_dir_a != is_dir_b) return is_dir_b - is_dir_a;
     return natural_strcasecmp(file_a->name, file_b->name);
 }
+int compareOrder(const void *a, const void *b) {
+    int id_a = *(const int *)a;
+    int id_b = *(const int *)b;
+    int diff = compareKey(&order_table[id_a], &order_table[id_b]);
+    return diff ? diff : id_a - id_b;
+}
+void sortFiles(struct FileInfo *files, int count, int *cursor_pos) {
+    const char *current = (cursor_pos && count > 0) ? files[*cursor_pos].name : NULL;
+    qsort(files, count, sizeof(struct FileInfo), compareFiles);
+    for (int i = 0; current && i < count; i++) {
+        if (files[i].name == current) {
+            *cursor_pos = i;
+            break;
+        }
+    }
+}
+int fileGroup(const struct FileInfo *file) {
+    return 2 * (!show_dotfiles && file->name[0] == '.') + !S_ISDIR(file->mode);
+}
+void arrangeFiles(struct FileInfo *files, int count, int **orders, int *cursor_pos) {
+    int current = (cursor_pos && count > 0) ? files[*cursor_pos].id : -1;
+    struct FileInfo *by_id = malloc((count > 0 ? count : 1) * sizeof(struct FileInfo));
+    if (by_id == NULL) die("malloc");
+    for (int i = 0; i < count; i++) by_id[files[i].id] = files[i];
+    if (orders[sort_mode] == NULL) {
+        int *order = malloc((count > 0 ? count : 1) * sizeof(int));
+        if (order == NULL) die("malloc");
+        for (int i = 0; i < count; i++) order[i] = i;
+        order_table = by_id;
+        if (sort_mode != SORT_NATURAL) qsort(order, count, sizeof(int), compareOrder);
+        orders[sort_mode] = order;
+    }
+    int n = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < count; i++) {
+            const struct FileInfo *file = &by_id[orders[sort_mode][i]];
+            if ((fileGroup(file) >> 1) == pass) files[n++] = *file;
+        }
+    }
+    free(by_id);
+    if (sort_reverse) reverseRuns(files, count, NULL);
+    for (int i = 0; current != -1 && i < count; i++) {
+        if (files[i].id == current) {
+            *cursor_pos = i;
+            break;
+        }
+    }
+}
+void reverseRuns(struct FileInfo *files, int count, int *cursor_pos) {
+    for (int start = 0, end; start < count; start = end) {
+        int group = fileGroup(&files[start]);
+        for (end = start + 1; end < count && fileGroup(&files[end]) == group; end++);
+        if (cursor_pos && *cursor_pos >= start && *cursor_pos < end) *cursor_pos = start + end - 1 - *cursor_pos;
+        for (int i = start, j = end - 1; i < j; i++, j--) {
+            struct FileInfo tmp = files[i];
+            files[i] = files[j];
+            files[j] = tmp;
+        }
+    }
+}
+void freeFiles(struct FileInfo *files, int count) {
+    for (int i = 0; i < count; i++) free(files[i].name);
+    free(files);
+}
+void setFileStat(struct FileInfo *file, const struct stat *st) {
+    file->mode = st->st_mode;
+    file->size = st->st_size;
+    file->mtime = st->st_mtime;
+    file->ctime = st->st_ctime;
+}
+struct FileInfo *readDirLocal(const char *path, int follow, int dotfiles, int max, int *count) {
+    DIR *d = opendir(path);
+    if (!d) return NULL;
+    int cap = 256, n = 0;
+    struct FileInfo *files = malloc(cap * sizeof(struct FileInfo));
+    if (files == NULL) die("malloc");
+    struct dirent *dir;
+    while (n < max && (dir = readdir(d)) != NULL) {
+        if (!dotfiles && dir->d_name[0] == '.') continue;
+        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
+        char item_path[MAX_PATH_LEN];
+        snprintf(item_path, sizeof(item_path), "%s/%s", path, dir->d_name);
+        struct stat st;
+        if ((follow ? stat(item_path, &st) : lstat(item_path, &st)) != 0) continue;
+        if (n == cap) {
+            cap *= 2;
+            struct FileInfo *grown = realloc(files, cap * sizeof(struct FileInfo));
+            if (grown == NULL) die("realloc");
+            files = grown;
+        }
+        files[n].name = strdup(dir->d_name);
+        setFileStat(&files[n], &st);
+        n++;
+    }
+    closedir(d);
+    qsort(files, n, sizeof(struct FileInfo), compareNatural);
+    *count = n;
+    return files;
+}
+char *packFiles(const struct FileInfo *files, int count, int *len) {
+    size_t total = 2 * sizeof(int);
+    for (int i = 0; i < count; i++) total += RECORD_LEN + sizeof(unsigned short) + strlen(files[i].name);
+    char *buf = malloc(total);
+    if (buf == NULL) die("malloc");
+    char *p = buf;
+    int magic = WIRE_MAGIC;
+    memcpy(p, &magic, sizeof(int));
+    p += sizeof(int);
+    memcpy(p, &count, sizeof(int));
+    p += sizeof(int);
+    for (int i = 0; i < count; i++) {
+        unsigned short name_len = strlen(files[i].name);
+        memcpy(p, &files[i], RECORD_LEN);
+        p += RECORD_LEN;
+        memcpy(p, &name_len, sizeof(name_len));
+        p += sizeof(name_len);
+        memcpy(p, files[i].name, name_len);
+        p += name_len;
+    }
+    *len = total;
+    return buf;
+}
+struct FileInfo *unpackFiles(const char *buf, int len, int *count) {
+    const char *p = buf, *end = buf + len;
+    int magic, n;
+    if (len < 2 * (int)sizeof(int)) return NULL;
+    memcpy(&magic, p, sizeof(int));
+    memcpy(&n, p + sizeof(int), sizeof(int));
+    p += 2 * sizeof(int);
+    if (magic != WIRE_MAGIC || n < 0) return NULL;
+    struct FileInfo *files = malloc((n > 0 ? n : 1) * sizeof(struct FileInfo));
+    if (files == NULL) die("malloc");
+    for (int i = 0; i < n; i++) {
+        unsigned short name_len;
+        if (end - p < (long)(RECORD_LEN + sizeof(name_len))) {
+            freeFiles(files, i);
+            return NULL;
+        }
+        memcpy(&files[i], p, RECORD_LEN);
+        p += RECORD_LEN;
+        memcpy(&name_len, p, sizeof(name_len));
+        p += sizeof(name_len);
+        if (end - p < name_len) {
+            freeFiles(files, i);
+            return NULL;
+        }
+        files[i].name = strndup(p, name_len);
+        p += name_len;
+        if (name_len == 0 || strchr(files[i].name, '/') || strcmp(files[i].name, ".") == 0 || strcmp(files[i].name, "..") == 0) {
+            freeFiles(files, i + 1);
+            return NULL;
+        }
+    }
+    *count = n;
+    return files;
+}
+int writeAll(int fd, const char *buf, int len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+int daemonSocketPath(char *buf, size_t size, int create) {
+    const char *base = getenv("XDG_RUNTIME_DIR");
+    if (!base) base = "/tmp";
+    char dir[MAX_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s/ll-%d", base, (int)getuid());
+    if (create) mkdir(dir, 0700);
+    struct stat st;
+    if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) return -1;
+    snprintf(buf, size, "%s/daemon.sock", dir);
+    return 0;
+}
+int peerIsSelf(int fd) {
+    #ifdef __linux__
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid();
+    #else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+    #endif
+}
+void setSocketTimeout(int fd, int seconds) {
+    struct timeval tv = {seconds, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+int connectDaemon() {
+    if (time(NULL) < daemon_retry_at) return -1;
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (daemonSocketPath(addr.sun_path, sizeof(addr.sun_path), 0) == -1) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || !peerIsSelf(fd)) {
+        close(fd);
+        return -1;
+    }
+    setSocketTimeout(fd, 1);
+    return fd;
+}
+int sendRequest(int fd, const char *path, int dotfiles, int flags) {
+    char req[MAX_PATH_LEN + 2];
+    req[0] = dotfiles;
+    req[1] = flags;
+    snprintf(req + 2, MAX_PATH_LEN, "%s", path);
+    return writeAll(fd, req, strlen(req + 2) + 3);
+}
+struct FileInfo *fetchFromDaemon(const char *path, int flags, int dotfiles, int *count) {
+    int fd = connectDaemon();
+    if (fd == -1) return NULL;
+    struct FileInfo *files = NULL;
+    if (sendRequest(fd, path, dotfiles, flags) == 0) {
+        struct abuf ab = ABUF_INIT;
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+            if (ab.len == 0) setSocketTimeout(fd, SCAN_TIMEOUT);
+            abAppend(&ab, chunk, n);
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) daemon_retry_at = time(NULL) + DAEMON_BACKOFF;
+        if (n == 0 && ab.b) files = unpackFiles(ab.b, ab.len, count);
+        abFree(&ab);
+    }
+    close(fd);
+    return files;
+}
+int watchDir(const char *path) {
+    int fd = connectDaemon();
+    if (fd == -1) return -1;
+    int ack = 0;
+    if (sendRequest(fd, path, 0, REQ_WATCH) == 0 && read(fd, &ack, sizeof(ack)) == sizeof(ack) && ack == WATCH_ACK) return fd;
+    close(fd);
+    return -1;
+}
+struct FileInfo *scanDir(const char *path, int follow, int dotfiles, int max, int *count) {
+    struct FileInfo *files = fetchFromDaemon(path, (follow ? REQ_FOLLOW : 0) | (max < INT_MAX ? REQ_NOWAIT : 0), dotfiles, count);
+    if (files == NULL) files = readDirLocal(path, follow, dotfiles, max, count);
+    return files;
+}
+struct FileInfo *paneListing(struct PaneCache *pane, const char *path, int follow, int *count) {
+    struct stat st;
+    if (stat(path, &st) != 0) return NULL;
+    if (pane->files && pane->follow == follow && pane->dotfiles == show_dotfiles && pane->sort == sort_mode && pane->reverse == sort_reverse &&
+        pane->mtime.tv_sec == ST_MTIME(st).tv_sec && pane->mtime.tv_nsec == ST_MTIME(st).tv_nsec && strcmp(pane->path, path) == 0) {
+        *count = pane->count;
+        return pane->files;
+    }
+    freeFiles(pane->files, pane->count);
+    pane->count = 0;
+    pane->files = scanDir(path, follow, show_dotfiles, MAX_PANE_FILES, &pane->count);
+    if (pane->files == NULL) return NULL;
+    if (sort_mode != SORT_NATURAL || sort_reverse) sortFiles(pane->files, pane->count, NULL);
+    snprintf(pane->path, sizeof(pane->path), "%s", path);
+    pane->follow = follow;
+    pane->dotfiles = show_dotfiles;
+    pane->sort = sort_mode;
+    pane->reverse = sort_reverse;
+    pane->mtime = ST_MTIME(st);
+    *count = pane->count;
+    return pane->files;
+}
+int watchInUse(int wd, const struct DirCache *except) {
+    for (int i = 0; i < CACHE_SLOTS; i++) {
+        struct DirCache *c = &dir_cache[i];
+        if (c != except && (c->snap || c->scanning) && c->wd == wd) return 1;
+    }
+    for (int i = 0; i < watcher_count; i++) {
+        if (watchers[i].wd == wd) return 1;
+    }
+    return 0;
+}
+void forgetWatch(int wd) {
+    #ifdef __linux__
+    if (wd != -1 && !watchInUse(wd, NULL)) inotify_rm_watch(dir_events, wd);
+    #endif
+}
+void dropWatcher(int i) {
+    int wd = watchers[i].wd;
+    close(watchers[i].fd);
+    watchers[i] = watchers[--watcher_count];
+    forgetWatch(wd);
+}
+void notifyWatchers(int wd) {
+    for (int i = watcher_count - 1; i >= 0; i--) {
+        if (wd == -1 || watchers[i].wd == wd) {
+            write(watchers[i].fd, "", 1);
+            dropWatcher(i);
+        }
+    }
+}
+int scanPending(int wd) {
+    for (int i = 0; i < CACHE_SLOTS; i++) {
+        if (dir_cache[i].scanning && dir_cache[i].wd == wd) return 1;
+    }
+    return 0;
+}
+void releaseSnapshot(struct Snapshot *snap) {
+    pthread_mutex_lock(&snapshot_lock);
+    int refs = --snap->refs;
+    pthread_mutex_unlock(&snapshot_lock);
+    if (refs == 0) {
+        free(snap->data);
+        free(snap);
+    }
+}
+void restatPacked(char *data, int len, const char *path, int follow) {
+    char *p = data + 2 * sizeof(int), *end = data + len;
+    while (p < end) {
+        struct FileInfo file;
+        unsigned short name_len;
+        memcpy(&file, p, RECORD_LEN);
+        memcpy(&name_len, p + RECORD_LEN, sizeof(name_len));
+        const char *name = p + RECORD_LEN + sizeof(name_len);
+        char item_path[MAX_PATH_LEN];
+        struct stat st;
+        if (snprintf(item_path, sizeof(item_path), "%s/%.*s", path, name_len, name) < (int)sizeof(item_path) &&
+            (follow ? stat(item_path, &st) : lstat(item_path, &st)) == 0) {
+            setFileStat(&file, &st);
+            memcpy(p, &file, RECORD_LEN);
+        }
+        p += RECORD_LEN + sizeof(name_len) + name_len;
+    }
+}
+void *sendWorker(void *arg) {
+    struct SendJob *job = arg;
+    struct Snapshot *snap = job->snap;
+    if (dir_events == -1) {
+        char *copy = malloc(snap->len);
+        if (copy == NULL) die("malloc");
+        memcpy(copy, snap->data, snap->len);
+        restatPacked(copy, snap->len, job->path, job->follow);
+        writeAll(job->fd, copy + job->skip, snap->len - job->skip);
+        free(copy);
+    } else {
+        writeAll(job->fd, snap->data + job->skip, snap->len - job->skip);
+    }
+    close(job->fd);
+    releaseSnapshot(snap);
+    free(job);
+    return NULL;
+}
+void sendSnapshot(struct DirCache *c, int fd, int skip) {
+    struct SendJob *job = malloc(sizeof(struct SendJob));
+    if (job == NULL) die("malloc");
+    snprintf(job->path, sizeof(job->path), "%s", c->path);
+    job->follow = c->follow;
+    job->fd = fd;
+    job->skip = skip;
+    job->snap = c->snap;
+    pthread_mutex_lock(&snapshot_lock);
+    c->snap->refs++;
+    pthread_mutex_unlock(&snapshot_lock);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, sendWorker, job) == 0) {
+        pthread_detach(thread);
+        return;
+    }
+    releaseSnapshot(job->snap);
+    free(job);
+    close(fd);
+}
+void *scanWorker(void *arg) {
+    struct ScanJob *job = arg;
+    struct stat st;
+    int count;
+    struct FileInfo *files = stat(job->path, &st) == 0 ? readDirLocal(job->path, job->follow, job->dotfiles, INT_MAX, &count) : NULL;
+    if (files) {
+        job->mtime = ST_MTIME(st);
+        job->snap = malloc(sizeof(struct Snapshot));
+        if (job->snap == NULL) die("malloc");
+        job->snap->data = packFiles(files, count, &job->snap->len);
+        job->snap->refs = 1;
+        freeFiles(files, count);
+    }
+    write(scan_done[1], &job, sizeof(job));
+    return NULL;
+}
+void startScan(struct DirCache *c) {
+    struct ScanJob *job = calloc(1, sizeof(struct ScanJob));
+    if (job == NULL) die("calloc");
+    snprintf(job->path, sizeof(job->path), "%s", c->path);
+    job->dotfiles = c->dotfiles;
+    job->follow = c->follow;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, scanWorker, job) != 0) {
+        free(job);
+        return;
+    }
+    pthread_detach(thread);
+    c->scanning = 1;
+    c->rescan = 0;
+    c->stale = 0;
+}
+void finishScan(struct ScanJob *job) {
+    struct DirCache *c = NULL;
+    for (int i = 0; i < CACHE_SLOTS && c == NULL; i++) {
+        struct DirCache *s = &dir_cache[i];
+        if (s->scanning && s->dotfiles == job->dotfiles && s->follow == job->follow && strcmp(s->path, job->path) == 0) c = s;
+    }
+    if (c == NULL) {
+        if (job->snap) releaseSnapshot(job->snap);
+        free(job);
+        return;
+    }
+    c->scanning = 0;
+    if (c->snap) releaseSnapshot(c->snap);
+    c->snap = job->snap;
+    c->mtime = job->mtime;
+    free(job);
+    int wd = c->wd;
+    if (c->snap && c->rescan) {
+        startScan(c);
+        if (c->scanning) return;
+    }
+    for (int i = 0; i < c->pending_count; i++) {
+        int failed = -1;
+        if (c->snap) {
+            sendSnapshot(c, c->pending[i], sizeof(int));
+        } else {
+            writeAll(c->pending[i], (char *)&failed, sizeof(failed));
+            close(c->pending[i]);
+        }
+    }
+    c->pending_count = 0;
+    if (c->snap == NULL) {
+        c->last_used = 0;
+        forgetWatch(wd);
+    }
+    if (c->notify) {
+        c->notify = 0;
+        if (!scanPending(wd)) notifyWatchers(wd);
+    }
+}
+#ifdef __linux__
+void drainDirEvents() {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = read(dir_events, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (int i = 0; i < CACHE_SLOTS; i++) {
+                    dir_cache[i].stale = 1;
+                    dir_cache[i].rescan = dir_cache[i].scanning;
+                }
+                notifyWatchers(-1);
+                continue;
+            }
+            int writing = event->mask == IN_MODIFY;
+            int watched = 0;
+            for (int i = 0; i < watcher_count; i++) {
+                if (watchers[i].wd == event->wd) watched = 1;
+            }
+            for (int i = 0; i < CACHE_SLOTS; i++) {
+                struct DirCache *c = &dir_cache[i];
+                if (!(c->snap || c->scanning) || c->wd != event->wd) continue;
+                c->stale = 1;
+                if (writing) continue;
+                c->notify |= watched;
+                if (c->scanning) c->rescan = 1;
+                else startScan(c);
+            }
+            if (!writing && watched && !scanPending(event->wd)) notifyWatchers(event->wd);
+        }
+    }
+}
+#endif
+struct DirCache *lookupDirCache(const char *path, int dotfiles, int follow, unsigned long tick) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) return NULL;
+    struct DirCache *slot = NULL;
+    for (int i = 0; i < CACHE_SLOTS && slot == NULL; i++) {
+        struct DirCache *c = &dir_cache[i];
+        if ((c->snap || c->scanning) && c->dotfiles == dotfiles && c->follow == follow && strcmp(c->path, path) == 0) slot = c;
+    }
+    if (slot) {
+        slot->last_used = tick;
+        int fresh = slot->snap && !slot->stale && slot->mtime.tv_sec == ST_MTIME(st).tv_sec && slot->mtime.tv_nsec == ST_MTIME(st).tv_nsec;
+        if (!fresh && !slot->scanning) startScan(slot);
+        return fresh || slot->scanning ? slot : NULL;
+    }
+    for (int i = 0; i < CACHE_SLOTS; i++) {
+        struct DirCache *c = &dir_cache[i];
+        if (!c->scanning && (slot == NULL || c->last_used < slot->last_used)) slot = c;
+    }
+    if (slot == NULL) return NULL;
+    int old_wd = slot->wd;
+    if (slot->snap) releaseSnapshot(slot->snap);
+    slot->snap = NULL;
+    forgetWatch(old_wd);
+    snprintf(slot->path, sizeof(slot->path), "%s", path);
+    slot->dotfiles = dotfiles;
+    slot->follow = follow;
+    slot->last_used = tick;
+    slot->stale = 0;
+    slot->rescan = 0;
+    slot->notify = 0;
+    slot->pending_count = 0;
+    slot->wd = -1;
+    #ifdef __linux__
+    if (dir_events != -1) {
+        slot->wd = inotify_add_watch(dir_events, path, WATCH_MASK);
+    }
+    #endif
+    startScan(slot);
+    return slot->scanning ? slot : NULL;
+}
+void serveClient(int srv, unsigned long *tick) {
+    int fd = accept(srv, NULL, NULL);
+    if (fd == -1) return;
+    if (!peerIsSelf(fd)) {
+        close(fd);
+        return;
+    }
+    setSocketTimeout(fd, 1);
+    char req[MAX_PATH_LEN + 2];
+    int len = 0;
+    ssize_t n;
+    while (len < (int)sizeof(req) && (n = read(fd, req + len, sizeof(req) - len)) > 0) {
+        len += n;
+        if (len > 2 && req[len - 1] == '\0') break;
+    }
+    if (len > 2 && req[len - 1] == '\0') {
+        #ifdef __linux__
+        if (dir_events != -1) drainDirEvents();
+        if (req[1] & REQ_WATCH) {
+            int wd = -1;
+            if (dir_events != -1 && watcher_count < MAX_WATCHERS) wd = inotify_add_watch(dir_events, req + 2, WATCH_MASK);
+            int ack = WATCH_ACK;
+            if (wd != -1 && writeAll(fd, (char *)&ack, sizeof(ack)) == 0) {
+                watchers[watcher_count].fd = fd;
+                watchers[watcher_count].wd = wd;
+                watcher_count++;
+                return;
+            }
+            forgetWatch(wd);
+            close(fd);
+            return;
+        }
+        #endif
+        struct DirCache *c = (req[1] & REQ_WATCH) ? NULL : lookupDirCache(req + 2, req[0], req[1] & REQ_FOLLOW, ++*tick);
+        int magic = WIRE_MAGIC;
+        if (c && !c->scanning) {
+            sendSnapshot(c, fd, 0);
+            return;
+        }
+        if (c && !(req[1] & REQ_NOWAIT) && c->pending_count < MAX_PENDING && writeAll(fd, (char *)&magic, sizeof(magic)) == 0) {
+            c->pending[c->pending_count++] = fd;
+            return;
+        }
+        int failed[2] = {WIRE_MAGIC, -1};
+        writeAll(fd, (char *)failed, sizeof(failed));
+    }
+    close(fd);
+}
+void runDaemon() {
+    int running = connectDaemon();
+    if (running != -1) {
+        close(running);
+        fprintf(stderr, "ll: a daemon is already running\n");
+        exit(1);
+    }
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (daemonSocketPath(addr.sun_path, sizeof(addr.sun_path), 1) == -1) {
+        errno = EACCES;
+        die("daemon socket directory");
+    }
+    int srv = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (srv == -1) die("socket");
+    unlink(addr.sun_path);
+    umask(077);
+    if (bind(srv, (struct sockaddr *)&addr, sizeof(addr)) == -1) die("bind");
+    if (listen(srv, 16) == -1) die("listen");
+    if (pipe(scan_done) == -1) die("pipe");
+    signal(SIGPIPE, SIG_IGN);
+    show_dotfiles = 1;
+    #ifdef __linux__
+    dir_events = inotify_init1(IN_NONBLOCK);
+    #endif
+    unsigned long tick = 0;
+    while (1) {
+        struct pollfd fds[3 + MAX_WATCHERS];
+        fds[0] = (struct pollfd){srv, POLLIN, 0};
+        fds[1] = (struct pollfd){dir_events, POLLIN, 0};
+        fds[2] = (struct pollfd){scan_done[0], POLLIN, 0};
+        for (int i = 0; i < watcher_count; i++) fds[3 + i] = (struct pollfd){watchers[i].fd, POLLIN, 0};
+        if (poll(fds, 3 + watcher_count, -1) == -1) continue;
+        for (int i = watcher_count - 1; i >= 0; i--) {
+            if (fds[3 + i].revents) dropWatcher(i);
+        }
+        #ifdef __linux__
+        if (fds[1].revents) drainDirEvents();
+        #endif
+        struct ScanJob *job;
+        if ((fds[2].revents & POLLIN) && read(scan_done[0], &job, sizeof(job)) == sizeof(job)) finishScan(job);
+        if (fds[0].revents & POLLIN) serveClient(srv, &tick);
+    }
+}
 void spawnShell(const char* current_path) {
     disableRawMode();
     write(STDOUT_FILENO, "\x1b[2J", 4);
@@ -213,40 +993,145 @@ void openFile(const char* file_path) {
         write(STDOUT_FILENO, "\x1b[?25l", 6);
     }
 }
-void runCommand() {
-    char cmd[MAX_PATH_LEN] = {0};
-    int cmd_len = 0;
-    char buf[MAX_PATH_LEN + 10];
-    snprintf(buf, sizeof(buf), "\x1b[%d;1H\x1b[2K:", screen_rows);
+int readPrompt(const char *prefix, char *input, int size) {
+    int len = 0;
+    input[0] = '\0';
+    char buf[MAX_PATH_LEN + 32];
+    snprintf(buf, sizeof(buf), "\x1b[%d;1H\x1b[2K%s", screen_rows, prefix);
     write(STDOUT_FILENO, buf, strlen(buf));
     write(STDOUT_FILENO, "\x1b[?25h", 6);
     while(1) {
         int c = readKey();
         if (c == KEY_ENTER) {
-            if (cmd_len > 0) break;
+            if (len > 0) break;
         } else if (c == KEY_ESC) {
-            cmd_len = 0;
+            len = 0;
             break;
         } else if (c == BACKSPACE) {
-            if (cmd_len > 0) cmd[--cmd_len] = '\0';
-        } else if (isprint(c) && cmd_len < MAX_PATH_LEN -1) {
-            cmd[cmd_len++] = c;
-            cmd[cmd_len] = '\0';
+            if (len > 0) input[--len] = '\0';
+        } else if (isprint(c) && len < size - 1) {
+            input[len++] = c;
+            input[len] = '\0';
         }
-        snprintf(buf, sizeof(buf), "\x1b[%d;1H\x1b[2K:%s", screen_rows, cmd);
+        snprintf(buf, sizeof(buf), "\x1b[%d;1H\x1b[2K%s%s", screen_rows, prefix, input);
         write(STDOUT_FILENO, buf, strlen(buf));
     }
     write(STDOUT_FILENO, "\x1b[?25l", 6);
-    if (cmd_len > 0) {
-        disableRawMode();
-        write(STDOUT_FILENO, "\x1b[2J", 4);
-        write(STDOUT_FILENO, "\x1b[H", 3);
-        system(cmd);
-        printf("\nPress any key to continue...");
-        fflush(stdout);
-        enableRawMode();
-        readKey();
+    return len;
+}
+int countBits(const unsigned long *set, int total) {
+    int count = 0;
+    for (size_t w = 0; w < BITSET_WORDS(total); w++) count += __builtin_popcountl(set[w]);
+    return count;
+}
+int countSelected(const unsigned long *selected, const unsigned long *hidden, int total) {
+    int count = 0;
+    for (size_t w = 0; w < BITSET_WORDS(total); w++) {
+        count += __builtin_popcountl(show_dotfiles ? selected[w] : selected[w] & ~hidden[w]);
+    }
+    return count;
+}
+void invertSelection(unsigned long *selected, const unsigned long *hidden, int total) {
+    size_t words = BITSET_WORDS(total);
+    for (size_t w = 0; w < words; w++) {
+        selected[w] ^= show_dotfiles ? ~0UL : ~hidden[w];
+    }
+    if (total % BITS_PER_WORD) selected[words - 1] &= (1UL << (total % BITS_PER_WORD)) - 1;
+}
+int compareNames(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+void carrySelection(const struct FileInfo *old_files, int old_count, const unsigned long *old_selected, const struct FileInfo *files, int count, unsigned long *selected) {
+    int kept_count = 0;
+    char **kept = malloc((countBits(old_selected, old_count) + 1) * sizeof(char *));
+    if (kept == NULL) return;
+    for (int i = 0; i < old_count; i++) {
+        if (BIT_TEST(old_selected, old_files[i].id)) kept[kept_count++] = old_files[i].name;
     }
+    qsort(kept, kept_count, sizeof(char *), compareNames);
+    for (int i = 0; kept_count > 0 && i < count; i++) {
+        if (bsearch(&files[i].name, kept, kept_count, sizeof(char *), compareNames)) BIT_SET(selected, files[i].id);
+    }
+    free(kept);
+}
+int runCommand(const char *current_path, const struct FileInfo *files, int file_count, const unsigned long *selected, int selected_count) {
+    char cmd[MAX_PATH_LEN];
+    if (readPrompt(":", cmd, sizeof(cmd)) == 0) return 0;
+    disableRawMode();
+    write(STDOUT_FILENO, "\x1b[2J", 4);
+    write(STDOUT_FILENO, "\x1b[H", 3);
+    const char *tmp_dir = getenv("TMPDIR");
+    if (tmp_dir == NULL || tmp_dir[0] == '\0') tmp_dir = "/tmp";
+    char list_path[MAX_PATH_LEN];
+    snprintf(list_path, sizeof(list_path), "%s/ll-selection-XXXXXX", tmp_dir);
+    int has_list = 0;
+    int list_fd = selected_count > 0 ? mkstemp(list_path) : -1;
+    if (list_fd != -1) {
+        FILE *list = fdopen(list_fd, "w");
+        if (list == NULL) {
+            close(list_fd);
+        } else {
+            for (int i = 0; i < file_count; i++) {
+                if (BIT_TEST(selected, files[i].id)) fwrite(files[i].name, strlen(files[i].name) + 1, 1, list);
+            }
+            has_list = fclose(list) == 0;
+        }
+        if (!has_list) unlink(list_path);
+    }
+    int refused_pipe[2];
+    if (pipe(refused_pipe) == -1) die("pipe");
+    fcntl(refused_pipe[1], F_SETFD, FD_CLOEXEC);
+    int ran = 1;
+    pid_t pid = fork();
+    if (pid == -1) {
+        die("fork");
+    } else if (pid == 0) {
+        close(refused_pipe[0]);
+        if (chdir(current_path) != 0) {
+            perror("chdir");
+            exit(1);
+        }
+        if (has_list) setenv("LL_SELECTION", list_path, 1);
+        char **args = malloc((selected_count + 5) * sizeof(char *));
+        if (args == NULL) exit(127);
+        int argc = 0;
+        args[argc++] = "sh";
+        args[argc++] = "-c";
+        args[argc++] = cmd;
+        args[argc++] = "sh";
+        for (int i = 0; selected_count > 0 && i < file_count; i++) {
+            if (BIT_TEST(selected, files[i].id)) args[argc++] = files[i].name;
+        }
+        args[argc] = NULL;
+        execv("/bin/sh", args);
+        if (errno == E2BIG && has_list && strstr(cmd, "LL_SELECTION")) {
+            fprintf(stderr, "ll: %d selected entries exceed the argument limit, \"$@\" is empty\n", selected_count);
+            args[4] = NULL;
+            execv("/bin/sh", args);
+        } else if (errno == E2BIG) {
+            fprintf(stderr, "ll: %d selected entries exceed the argument limit, command not run\n"
+                            "ll: rerun it with the NUL-separated list, e.g. xargs -0 ... < \"$LL_SELECTION\"\n", selected_count);
+            write(refused_pipe[1], "", 1);
+        }
+        exit(127);
+    } else {
+        int status;
+        char refused;
+        close(refused_pipe[1]);
+        signal(SIGINT, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+        waitpid(pid, &status, 0);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        if (read(refused_pipe[0], &refused, 1) == 1) ran = 0;
+        close(refused_pipe[0]);
+        if (has_list) unlink(list_path);
+    }
+    printf("\nPress any key to continue...");
+    fflush(stdout);
+    enableRawMode();
+    readKey();
+    return ran;
 }
 const char* getFileColor(const char *filename, mode_t mode) {
     if (S_ISLNK(mode)) return C_LINK;
@@ -302,25 +1187,9 @@ const char* getFileIcon(const char *filename, mode_t mode) {
     return "";
 }
 void drawParentPane(struct abuf *ab, const char *path, const char* highlight_name, int x, int width, int height) {
-    DIR *d = opendir(path);
-    if (!d) return;
-    struct FileInfo entries[MAX_FILES];
     int entry_count = 0;
-    struct dirent *dir;
-    while ((dir = readdir(d)) != NULL && entry_count < MAX_FILES) {
-        if (!show_dotfiles && dir->d_name[0] == '.') continue;
-        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
-        char item_path[MAX_PATH_LEN];
-        snprintf(item_path, sizeof(item_path), "%s/%s", path, dir->d_name);
-        struct stat item_st;
-        if (lstat(item_path, &item_st) == 0) {
-            entries[entry_count].name = strdup(dir->d_name);
-            entries[entry_count].mode = item_st.st_mode;
-            entry_count++;
-        }
-    }
-    closedir(d);
-    qsort(entries, entry_count, sizeof(struct FileInfo), compareFiles);
+    struct FileInfo *entries = paneListing(&parent_pane, path, 0, &entry_count);
+    if (!entries) return;
     int highlight_idx = -1;
     if (highlight_name) {
         for (int i = 0; i < entry_count; i++) {
@@ -358,10 +1227,92 @@ void drawParentPane(struct abuf *ab, const char *path, const char* highlight_nam
         }
         abAppend(ab, line, strlen(line));
     }
-    for (int i = 0; i < entry_count; i++) free(entries[i].name);
 }
-void drawPreviewPane(struct abuf *ab, const char *base_path, const char *filename, int start_col, int width, int height) {
-    if (!filename) return;
+void hexChunk(const unsigned char *bytes, char *hex, char *ascii) {
+    #ifdef __SSE2__
+    __m128i data = _mm_loadu_si128((const __m128i *)bytes);
+    __m128i low_mask = _mm_set1_epi8(0x0f);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(data, 4), low_mask);
+    __m128i lo = _mm_and_si128(data, low_mask);
+    __m128i nine = _mm_set1_epi8(9);
+    __m128i zero = _mm_set1_epi8('0');
+    __m128i letter = _mm_set1_epi8('a' - '0' - 10);
+    hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letter));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letter));
+    _mm_storeu_si128((__m128i *)hex, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i *)(hex + 16), _mm_unpackhi_epi8(hi, lo));
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(data, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(data, _mm_set1_epi8(0x7f)));
+    __m128i dots = _mm_andnot_si128(printable, _mm_set1_epi8('.'));
+    _mm_storeu_si128((__m128i *)ascii, _mm_or_si128(_mm_and_si128(printable, data), dots));
+    #elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t data = vld1q_u8(bytes);
+    uint8x16_t digits = vld1q_u8((const uint8_t *)"0123456789abcdef");
+    uint8x16_t hi = vqtbl1q_u8(digits, vshrq_n_u8(data, 4));
+    uint8x16_t lo = vqtbl1q_u8(digits, vandq_u8(data, vdupq_n_u8(0x0f)));
+    uint8x16x2_t pairs = vzipq_u8(hi, lo);
+    vst1q_u8((uint8_t *)hex, pairs.val[0]);
+    vst1q_u8((uint8_t *)(hex + 16), pairs.val[1]);
+    uint8x16_t printable = vandq_u8(vcgtq_u8(data, vdupq_n_u8(0x1f)), vcltq_u8(data, vdupq_n_u8(0x7f)));
+    vst1q_u8((uint8_t *)ascii, vbslq_u8(printable, data, vdupq_n_u8('.')));
+    #else
+    const char *digits = "0123456789abcdef";
+    for (int i = 0; i < HEX_CHUNK; i++) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+        ascii[i] = (bytes[i] >= 0x20 && bytes[i] < 0x7f) ? bytes[i] : '.';
+    }
+    #endif
+}
+int formatHexRow(char *out, off_t offset, int digits, const unsigned char *bytes, int count, int per_row) {
+    char hex[2 * HEX_CHUNK], ascii[HEX_CHUNK];
+    hexChunk(bytes, hex, ascii);
+    int len = sprintf(out, "%0*llx: ", digits, (unsigned long long)offset);
+    for (int i = 0; i < per_row; i += 2) {
+        if (i + 1 < count) {
+            memcpy(out + len, hex + 2 * i, 4);
+        } else if (i < count) {
+            memcpy(out + len, hex + 2 * i, 2);
+            memcpy(out + len + 2, "  ", 2);
+        } else {
+            memcpy(out + len, "    ", 4);
+        }
+        out[len + 4] = ' ';
+        len += 5;
+    }
+    out[len++] = ' ';
+    memcpy(out + len, ascii, count);
+    len += count;
+    out[len] = '\0';
+    return len;
+}
+off_t drawHexDump(struct abuf *ab, int fd, off_t size, int start_col, int width, int height, off_t *offset) {
+    int digits = 8;
+    while (digits < 16 && size > 0 && ((unsigned long long)(size - 1) >> (4 * digits)) != 0) digits++;
+    int per_row = HEX_CHUNK;
+    while (per_row > 2 && digits + 3 + per_row / 2 * 5 + per_row > width - 2) per_row /= 2;
+    off_t page = (off_t)per_row * height;
+    off_t last_row = size > 0 ? (size - 1) / per_row * per_row : 0;
+    off_t max_offset = last_row - (off_t)(height - 1) * per_row;
+    if (*offset > max_offset) *offset = max_offset;
+    if (*offset < 0) *offset = 0;
+    *offset -= *offset % per_row;
+    unsigned char *data = calloc(page + HEX_CHUNK, 1);
+    if (data == NULL) return 0;
+    ssize_t got = pread(fd, data, page, *offset);
+    char line[32 + 7 * HEX_CHUNK];
+    for (int row = 0; got > 0 && row * per_row < got; row++) {
+        int count = got - row * per_row < per_row ? got - row * per_row : per_row;
+        char pos_buf[32];
+        snprintf(pos_buf, sizeof(pos_buf), "\x1b[%d;%dH", row + 2, start_col + 2);
+        abAppend(ab, pos_buf, strlen(pos_buf));
+        int len = formatHexRow(line, *offset + (off_t)row * per_row, digits, data + row * per_row, count, per_row);
+        abAppend(ab, line, len < width - 2 ? len : width - 2);
+    }
+    free(data);
+    return page;
+}
+off_t drawPreviewPane(struct abuf *ab, const char *base_path, const char *filename, int start_col, int width, int height, off_t *offset) {
+    if (!filename) return 0;
     char path[MAX_PATH_LEN];
     if (strcmp(base_path, "/") == 0) {
         snprintf(path, sizeof(path), "/%s", filename);
@@ -369,27 +1320,11 @@ void drawPreviewPane(struct abuf *ab, const char *base_path, const char *filenam
         snprintf(path, sizeof(path), "%s/%s", base_path, filename);
     }
     struct stat path_stat;
-    if (stat(path, &path_stat) != 0) return;
+    if (stat(path, &path_stat) != 0) return 0;
     if (S_ISDIR(path_stat.st_mode)) {
-        DIR *d = opendir(path);
-        if (!d) return;
-        struct FileInfo preview_entries[MAX_FILES];
         int entry_count = 0;
-        struct dirent *dir;
-        while ((dir = readdir(d)) != NULL && entry_count < MAX_FILES) {
-            if (!show_dotfiles && dir->d_name[0] == '.') continue;
-            if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
-            char item_path[MAX_PATH_LEN];
-            snprintf(item_path, sizeof(item_path), "%s/%s", path, dir->d_name);
-            struct stat item_st;
-            if (stat(item_path, &item_st) == 0) {
-                preview_entries[entry_count].name = strdup(dir->d_name);
-                preview_entries[entry_count].mode = item_st.st_mode;
-                entry_count++;
-            }
-        }
-        closedir(d);
-        qsort(preview_entries, entry_count, sizeof(struct FileInfo), compareFiles);
+        struct FileInfo *preview_entries = paneListing(&preview_pane, path, 1, &entry_count);
+        if (!preview_entries) return 0;
         if (entry_count == 0) {
             char buf[64];
             snprintf(buf, sizeof(buf), "\x1b[2;%dH-- empty --", start_col + 2);
@@ -419,10 +1354,9 @@ void drawPreviewPane(struct abuf *ab, const char *base_path, const char *filenam
                 abAppend(ab, line_buf, strlen(line_buf));
             }
         }
-        for (int i = 0; i < entry_count; i++) free(preview_entries[i].name);
     } else if (S_ISREG(path_stat.st_mode)) {
         FILE *f = fopen(path, "r");
-        if (!f) return;
+        if (!f) return 0;
         char line[2048];
         int y = 2;
         int is_binary = 0;
@@ -435,9 +1369,9 @@ void drawPreviewPane(struct abuf *ab, const char *base_path, const char *filenam
         }
         rewind(f);
         if (is_binary) {
-            char buf[64];
-            snprintf(buf, sizeof(buf), "\x1b[2;%dH-- Binary File --", start_col + 2);
-            abAppend(ab, buf, strlen(buf));
+            off_t page = drawHexDump(ab, fileno(f), path_stat.st_size, start_col, width, height, offset);
+            fclose(f);
+            return page;
         } else {
             while (fgets(line, sizeof(line), f) && y <= height + 1) {
                 if (strlen(line) > 0 && line[strlen(line) - 1] == '\n') {
@@ -453,19 +1387,32 @@ void drawPreviewPane(struct abuf *ab, const char *base_path, const char *filenam
         }
         fclose(f);
     }
+    return 0;
 }
 void listDir(const char *initial_path) {
     char current_path[MAX_PATH_LEN];
     strncpy(current_path, initial_path, MAX_PATH_LEN - 1);
     current_path[MAX_PATH_LEN - 1] = '\0';
-    struct FileInfo files[MAX_FILES];
+    struct FileInfo *files = NULL;
     int file_count = 0;
+    int total_count = 0;
+    unsigned long *selected = NULL;
+    unsigned long *hidden = NULL;
+    int *orders[SORT_COUNT] = {NULL};
+    int mark_anchor = -1;
+    off_t preview_offset = 0;
+    off_t preview_page = 0;
+    int preview_id = -1;
     int cursor_pos = 0;
     int scroll_offset = 0;
+    int keep_cursor = 0;
+    int keep_selection = 0;
+    int watch_fd = -1;
     char previous_dir_name[MAX_PATH_LEN] = "";
     while (1) {
-        DIR *d = opendir(current_path);
-        if (!d) {
+        int new_count = 0;
+        struct FileInfo *new_files = scanDir(current_path, 0, 1, INT_MAX, &new_count);
+        if (!new_files) {
             char temp_path[MAX_PATH_LEN];
             strncpy(temp_path, current_path, MAX_PATH_LEN);
             char *last_slash = strrchr(temp_path, '/');
@@ -474,23 +1421,30 @@ void listDir(const char *initial_path) {
             strncpy(current_path, temp_path, MAX_PATH_LEN);
             continue;
         }
-        for (int i = 0; i < file_count; i++) free(files[i].name);
-        file_count = 0;
-        struct dirent *dir;
-        while ((dir = readdir(d)) != NULL && file_count < MAX_FILES) {
-            if (!show_dotfiles && dir->d_name[0] == '.') continue;
-            if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
-            char path_buf[MAX_PATH_LEN];
-            snprintf(path_buf, sizeof(path_buf), "%s/%s", current_path, dir->d_name);
-            struct stat st;
-            if (lstat(path_buf, &st) == 0) {
-                files[file_count].name = strdup(dir->d_name);
-                files[file_count].mode = st.st_mode;
-                file_count++;
-            }
+        unsigned long *new_selected = calloc(BITSET_WORDS(new_count) + 1, sizeof(unsigned long));
+        free(hidden);
+        hidden = calloc(BITSET_WORDS(new_count) + 1, sizeof(unsigned long));
+        if (new_selected == NULL || hidden == NULL) die("calloc");
+        for (int i = 0; i < new_count; i++) {
+            new_files[i].id = i;
+            if (new_files[i].name[0] == '.') BIT_SET(hidden, i);
+        }
+        if (keep_selection && selected) carrySelection(files, total_count, selected, new_files, new_count, new_selected);
+        freeFiles(files, total_count);
+        free(selected);
+        files = new_files;
+        total_count = new_count;
+        selected = new_selected;
+        for (int i = 0; i < SORT_COUNT; i++) {
+            free(orders[i]);
+            orders[i] = NULL;
         }
-        closedir(d);
-        qsort(files, file_count, sizeof(struct FileInfo), compareFiles);
+        arrangeFiles(files, total_count, orders, NULL);
+        if (watch_fd != -1) close(watch_fd);
+        watch_fd = watchDir(current_path);
+        file_count = show_dotfiles ? total_count : total_count - countBits(hidden, total_count);
+        mark_anchor = -1;
+        preview_id = -1;
         if (strlen(previous_dir_name) > 0) {
             int found = 0;
             for (int i = 0; i < file_count; i++) {
@@ -500,14 +1454,13 @@ void listDir(const char *initial_path) {
                     break;
                 }
             }
-            if (!found) cursor_pos = 0;
+            if (!found && !keep_cursor) cursor_pos = 0;
             previous_dir_name[0] = '\0';
-        } else {
-            if (cursor_pos >= file_count) {
-                cursor_pos = file_count > 0 ? file_count - 1 : 0;
-            }
         }
-        if (file_count == 0) cursor_pos = 0;
+        if (cursor_pos >= file_count) cursor_pos = file_count > 0 ? file_count - 1 : 0;
+        if (keep_cursor && file_count > 0) preview_id = files[cursor_pos].id;
+        keep_cursor = 0;
+        keep_selection = 0;
         int redraw = 1;
         while(1) {
             if (redraw) {
@@ -620,7 +1573,7 @@ void listDir(const char *initial_path) {
                             full_name[display_width] = '\0';
                         }
                         char line_content[middle_pane_width + 2];
-                        snprintf(line_content, sizeof(line_content), " %s", full_name);
+                        snprintf(line_content, sizeof(line_content), "%c%s", BIT_TEST(selected, files[idx].id) ? '*' : ' ', full_name);
                         char line[middle_pane_width + 64];
                         char pos_buf[32];
                         snprintf(pos_buf, sizeof(pos_buf), "\x1b[%d;%dH", i + 2, middle_pane_x);
@@ -633,40 +1586,145 @@ void listDir(const char *initial_path) {
                         abAppend(&ab, line, strlen(line));
                     }
                 }
+                char status[96];
+                int status_len = 0;
+                int selected_count = countSelected(selected, hidden, total_count);
+                if (selected_count > 0) {
+                    status_len += snprintf(status, sizeof(status), "%d selected", selected_count);
+                }
+                if (sort_mode != SORT_NATURAL || sort_reverse) {
+                    status_len += snprintf(status + status_len, sizeof(status) - status_len, "%ssort: %s%s",
+                                           status_len > 0 ? "  " : "", sort_names[sort_mode], sort_reverse ? " (reversed)" : "");
+                }
+                if (status_len > 0) {
+                    char pos_buf[32];
+                    snprintf(pos_buf, sizeof(pos_buf), "\x1b[%d;%dH", screen_rows, screen_cols - status_len);
+                    abAppend(&ab, pos_buf, strlen(pos_buf));
+                    abAppend(&ab, status, status_len);
+                }
                 if (file_count > 0) {
-                    drawPreviewPane(&ab, current_path, files[cursor_pos].name, right_pane_x, right_pane_width, screen_rows - 2);
+                    if (files[cursor_pos].id != preview_id) {
+                        preview_id = files[cursor_pos].id;
+                        preview_offset = 0;
+                    }
+                    preview_page = drawPreviewPane(&ab, current_path, files[cursor_pos].name, right_pane_x, right_pane_width, screen_rows - 2, &preview_offset);
                 }
                 write(STDOUT_FILENO, ab.b, ab.len);
                 abFree(&ab);
                 redraw = 0;
             }
-            int c = readKey();
+            int c = waitKey(watch_fd);
             switch (c) {
                 case KEY_QUIT:
                     write(STDOUT_FILENO, "\x1b[2J", 4);
                     write(STDOUT_FILENO, "\x1b[H", 3);
                     write(STDOUT_FILENO, "\x1b[?25h", 6);
-                    for (int i = 0; i < file_count; i++) free(files[i].name);
+                    freeFiles(files, total_count);
+                    free(selected);
+                    free(hidden);
                     exit(0);
+                case DIR_CHANGED:
+                    if (file_count > 0) snprintf(previous_dir_name, sizeof(previous_dir_name), "%s", files[cursor_pos].name);
+                    keep_cursor = 1;
+                    keep_selection = 1;
+                    goto next_dir;
                 case KEY_UP: case ARROW_UP:
                     if (cursor_pos > 0) { cursor_pos--; redraw = 1; }
                     break;
                 case KEY_DOWN: case ARROW_DOWN:
                     if (cursor_pos < file_count - 1) { cursor_pos++; redraw = 1; }
                     break;
+                case KEY_PAGE_DOWN:
+                    if (preview_page > 0) { preview_offset += preview_page; redraw = 1; }
+                    break;
+                case KEY_PAGE_UP:
+                    if (preview_page > 0 && preview_offset > 0) {
+                        preview_offset = preview_offset > preview_page ? preview_offset - preview_page : 0;
+                        redraw = 1;
+                    }
+                    break;
+                case KEY_SEEK: {
+                    char target[64];
+                    if (preview_page > 0 && readPrompt("offset: ", target, sizeof(target)) > 0) {
+                        int is_hex = strncasecmp(target, "0x", 2) == 0;
+                        char *digits = target + (is_hex ? 2 : 0), *end;
+                        errno = 0;
+                        unsigned long long value = strtoull(digits, &end, is_hex ? 16 : 10);
+                        int valid = is_hex ? isxdigit((unsigned char)*digits) : isdigit((unsigned char)*digits);
+                        if (valid && *end == '\0' && errno == 0) preview_offset = (off_t)value;
+                    }
+                    redraw = 1;
+                    break;
+                }
                 case KEY_SHELL:
                     spawnShell(current_path);
                     redraw = 1;
                     break;
                 case KEY_ENTER:
-                    runCommand();
+                    if (runCommand(current_path, files, file_count, selected, countSelected(selected, hidden, total_count))) {
+                        if (file_count > 0) snprintf(previous_dir_name, sizeof(previous_dir_name), "%s", files[cursor_pos].name);
+                        keep_cursor = 1;
+                        goto next_dir;
+                    }
+                    redraw = 1;
+                    break;
+                case KEY_SORT:
+                    sort_mode = (sort_mode + 1) % SORT_COUNT;
+                    arrangeFiles(files, total_count, orders, &cursor_pos);
+                    mark_anchor = -1;
+                    redraw = 1;
+                    break;
+                case KEY_REVERSE:
+                    sort_reverse = !sort_reverse;
+                    reverseRuns(files, total_count, &cursor_pos);
+                    mark_anchor = -1;
                     redraw = 1;
                     break;
                 case KEY_TOGGLE_DOTFILES:
                     show_dotfiles = !show_dotfiles;
-                    cursor_pos = 0; scroll_offset = 0;
-                    previous_dir_name[0] = '\0';
-                    goto next_dir;
+                    arrangeFiles(files, total_count, orders, &cursor_pos);
+                    file_count = show_dotfiles ? total_count : total_count - countBits(hidden, total_count);
+                    if (cursor_pos >= file_count) cursor_pos = file_count > 0 ? file_count - 1 : 0;
+                    mark_anchor = -1;
+                    redraw = 1;
+                    break;
+                case KEY_MARK:
+                    if (file_count > 0) {
+                        BIT_FLIP(selected, files[cursor_pos].id);
+                        mark_anchor = cursor_pos;
+                        if (cursor_pos < file_count - 1) cursor_pos++;
+                        redraw = 1;
+                    }
+                    break;
+                case KEY_MARK_RANGE:
+                    if (file_count > 0) {
+                        int from = mark_anchor == -1 ? cursor_pos : mark_anchor;
+                        int to = cursor_pos;
+                        if (from > to) { int t = from; from = to; to = t; }
+                        for (int i = from; i <= to; i++) BIT_SET(selected, files[i].id);
+                        mark_anchor = cursor_pos;
+                        redraw = 1;
+                    }
+                    break;
+                case KEY_MARK_GLOB: {
+                    char pattern[MAX_PATH_LEN];
+                    if (readPrompt("glob: ", pattern, sizeof(pattern)) > 0) {
+                        for (int i = 0; i < file_count; i++) {
+                            if (fnmatch(pattern, files[i].name, 0) == 0) BIT_SET(selected, files[i].id);
+                        }
+                    }
+                    redraw = 1;
+                    break;
+                }
+                case KEY_INVERT:
+                    invertSelection(selected, hidden, total_count);
+                    redraw = 1;
+                    break;
+                case KEY_UNMARK:
+                    memset(selected, 0, BITSET_WORDS(total_count) * sizeof(unsigned long));
+                    mark_anchor = -1;
+                    redraw = 1;
+                    break;
                 case KEY_BACK: case ARROW_LEFT: {
                     char *last_slash = strrchr(current_path, '/');
                     if (last_slash && last_slash != current_path) {
@@ -719,6 +1777,10 @@ void listDir(const char *initial_path) {
 }
 int main(int argc, char *argv[]) {
     char initial_path[MAX_PATH_LEN];
+    if (argc > 1 && strcmp(argv[1], "--daemon") == 0) {
+        runDaemon();
+        return 0;
+    }
     if (argc > 1) {
         realpath(argv[1], initial_path);
     } else {